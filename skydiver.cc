@@ -1,10 +1,23 @@
+#ifdef SKYDIVER_SDL2
+#include <SDL2/SDL.h>
+#include <SDL2/SDL2_gfxPrimitives.h>
+#include <SDL2/SDL2_framerate.h>
+#else
 #include <SDL/SDL.h>
 #include <SDL/SDL_gfxPrimitives.h>
 #include <SDL/SDL_framerate.h>
+#endif
 
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <stdint.h>
+#include <cstring>
 #include <cassert>
+#include <climits>
 #include <ctime>
+#include <map>
+#include <vector>
 #include <sys/time.h>
 
 static const float GLOBAL_FPS = 30.0;
@@ -23,6 +36,140 @@ millitime(void) {
     return now.tv_sec + (now.tv_usec / 1000000.0);
 }
 
+/**
+ * 24.8 fixed-point number for positions and velocities. Integer maths
+ * only, so the simulation is bit-identical whatever the compiler or
+ * optimisation level. 24 integer bits leave room for the viewport to
+ * scroll a long way, and a coordinate is still one 32-bit word.
+ *
+ * Relies on >> of a negative value being an arithmetic shift, as it is
+ * with every compiler we build on.
+ *
+ * Values live in their sprites rather than packed arrays, there are
+ * only a dozen or so and each kind moves by its own rule.
+ */
+class Fixed {
+public:
+    static const int FRAC_BITS = 8;
+    static const int32_t ONE = 1 << FRAC_BITS;
+
+    Fixed()
+    : m_raw(0)
+    { }
+
+    Fixed(int whole)
+    : m_raw(whole * ONE)
+    { }
+
+    static Fixed fromRaw(int32_t raw) {
+        Fixed ret;
+        ret.m_raw = raw;
+        return ret;
+    }
+
+    /* For constants which aren't whole, e.g. fromRatio(6, 5) is 1.2 */
+    static Fixed fromRatio(int num, int den) {
+        return fromRaw(((int64_t)num * ONE) / den);
+    }
+
+    static Fixed max() {
+        return fromRaw(INT32_MAX);
+    }
+
+    static Fixed min() {
+        return fromRaw(INT32_MIN);
+    }
+
+    int32_t raw() const {
+        return m_raw;
+    }
+
+    int floor() const {
+        return m_raw >> FRAC_BITS;
+    }
+
+    int ceil() const {
+        return (m_raw + ONE - 1) >> FRAC_BITS;
+    }
+
+    Fixed operator+(Fixed b) const { return fromRaw(m_raw + b.m_raw); }
+    Fixed operator-(Fixed b) const { return fromRaw(m_raw - b.m_raw); }
+    Fixed operator-() const { return fromRaw(-m_raw); }
+
+    Fixed operator*(Fixed b) const {
+        return fromRaw(((int64_t)m_raw * b.m_raw) >> FRAC_BITS);
+    }
+
+    /* Saturates rather than wrapping, sweep() divides by tiny movements */
+    Fixed operator/(Fixed b) const {
+        int64_t q = ((int64_t)m_raw * ONE) / b.m_raw;
+        if( q > INT32_MAX ) return max();
+        if( q < INT32_MIN ) return min();
+        return fromRaw(q);
+    }
+
+    Fixed &operator+=(Fixed b) { return *this = *this + b; }
+    Fixed &operator-=(Fixed b) { return *this = *this - b; }
+    Fixed &operator*=(Fixed b) { return *this = *this * b; }
+    Fixed &operator/=(Fixed b) { return *this = *this / b; }
+
+    bool operator==(Fixed b) const { return m_raw == b.m_raw; }
+    bool operator!=(Fixed b) const { return m_raw != b.m_raw; }
+    bool operator<(Fixed b) const { return m_raw < b.m_raw; }
+    bool operator<=(Fixed b) const { return m_raw <= b.m_raw; }
+    bool operator>(Fixed b) const { return m_raw > b.m_raw; }
+    bool operator>=(Fixed b) const { return m_raw >= b.m_raw; }
+
+private:
+    // No silent conversions from floating point, that's what this replaces
+    Fixed(double);
+
+    int32_t m_raw;
+};
+
+/* Angles are in 1/1024ths of a circle, so they wrap with a mask */
+static const int ANGLE_CIRCLE = 1024;
+
+/**
+ * Sine of an angle, table driven so no libm is involved. The quarter
+ * wave is in Q16 with 64 steps, interpolated to the full resolution.
+ */
+Fixed
+fixedSin(int angle) {
+    static const int32_t quarter[65] = {
+            0,  1608,  3216,  4821,  6424,  8022,  9616, 11204,
+        12785, 14359, 15924, 17479, 19024, 20557, 22078, 23586,
+        25080, 26558, 28020, 29466, 30893, 32303, 33692, 35062,
+        36410, 37736, 39040, 40320, 41576, 42806, 44011, 45190,
+        46341, 47464, 48559, 49624, 50660, 51665, 52639, 53581,
+        54491, 55368, 56212, 57022, 57798, 58538, 59244, 59914,
+        60547, 61145, 61705, 62228, 62714, 63162, 63572, 63944,
+        64277, 64571, 64827, 65043, 65220, 65358, 65457, 65516,
+        65536,
+    };
+    int a = angle & (ANGLE_CIRCLE - 1);
+    int quadrant = a / (ANGLE_CIRCLE / 4);
+    int step = a % (ANGLE_CIRCLE / 4);
+    if( quadrant % 2 ) {
+        step = (ANGLE_CIRCLE / 4) - step;
+    }
+
+    int i = step / 4;
+    int32_t value = quarter[i];
+    if( i < 64 ) {
+        value += ((quarter[i + 1] - value) * (step % 4)) / 4;
+    }
+    if( quadrant >= 2 ) {
+        value = -value;
+    }
+    return Fixed::fromRaw(value / (1 << (16 - Fixed::FRAC_BITS)));
+}
+
+Fixed
+fixedCos(int angle) {
+    return fixedSin(angle + (ANGLE_CIRCLE / 4));
+}
+
 class Rect {
 private:
     int m_x, m_y;
@@ -114,21 +261,378 @@ public:
     }
 };
 
+/**
+ * Drawing backend, everything that reaches the screen goes through here.
+ * Coordinates are screen pixels, colours are RGBA.
+ */
+class Renderer {
+public:
+    virtual ~Renderer() {}
+
+    virtual int width() = 0;
+    virtual int height() = 0;
+
+    virtual void clear(Uint8 r, Uint8 g, Uint8 b) = 0;
+    virtual void fillRect(SDL_Rect *rect, Uint8 r, Uint8 g, Uint8 b, Uint8 a) = 0;
+    virtual void filledCircle(int x, int y, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a) = 0;
+    virtual void filledTrigon(int x1, int y1, int x2, int y2, int x3, int y3, Uint8 r, Uint8 g, Uint8 b, Uint8 a) = 0;
+    virtual void text(int x, int y, const char *str, Uint8 r, Uint8 g, Uint8 b, Uint8 a) = 0;
+    virtual void blit(SDL_Surface *surface, SDL_Rect *dstrect, bool blend) = 0;
+    virtual void present() = 0;
+
+    /* The surface is about to be freed, drop anything cached for it */
+    virtual void release(SDL_Surface *surface) {}
+
+    /* The surface's pixels were repainted, refresh anything cached for it */
+    virtual void update(SDL_Surface *surface) {}
+
+    /* Draw at a fraction of the window resolution, where supported */
+    virtual void setRenderScale(double scale) {}
+};
+
+/**
+ * Sprites are painted once into their own surface when created,
+ * SDL2_gfx only draws via a renderer so borrow a software one.
+ */
+void
+surfaceFilledEllipse(SDL_Surface *surface, int x, int y, int rx, int ry, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+#ifdef SKYDIVER_SDL2
+    SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(surface);
+    filledEllipseRGBA(renderer, x, y, rx, ry, r, g, b, a);
+    SDL_DestroyRenderer(renderer);
+#else
+    filledEllipseRGBA(surface, x, y, rx, ry, r, g, b, a);
+#endif
+}
+
+#ifdef SKYDIVER_SDL2
+/**
+ * SDL_Renderer backend, sprites are uploaded as textures on first use
+ * and consecutive draws sharing a texture (or untextured geometry) are
+ * submitted as one SDL_RenderGeometry batch.
+ */
+class Accelerated_Renderer : public Renderer {
+public:
+    Accelerated_Renderer(SDL_Window *window)
+    : m_renderer(NULL), m_batch_texture(NULL), m_target(NULL), m_scale(1.0)
+    , m_width(0), m_height(0)
+    {
+        // Honours SDL_RENDER_DRIVER, with the software renderer as the fallback
+        m_renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+        if( ! m_renderer ) {
+            m_renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+        }
+        assert(m_renderer != NULL);
+        SDL_GetWindowSize(window, &m_width, &m_height);
+    }
+
+    virtual ~Accelerated_Renderer() {
+        std::map<SDL_Surface*, SDL_Texture*>::iterator it;
+        for( it = m_textures.begin(); it != m_textures.end(); it++ ) {
+            SDL_DestroyTexture(it->second);
+        }
+        if( m_target ) {
+            SDL_DestroyTexture(m_target);
+        }
+        SDL_DestroyRenderer(m_renderer);
+    }
+
+    virtual int width() {
+        return m_width;
+    }
+
+    virtual int height() {
+        return m_height;
+    }
+
+    virtual void clear(Uint8 r, Uint8 g, Uint8 b) {
+        m_vertices.clear();
+        m_indices.clear();
+        SDL_SetRenderDrawColor(m_renderer, r, g, b, 0xff);
+        SDL_RenderClear(m_renderer);
+    }
+
+    virtual void fillRect(SDL_Rect *rect, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        SDL_Rect screen;
+        if( ! rect ) {
+            screen.x = 0;
+            screen.y = 0;
+            screen.w = m_width;
+            screen.h = m_height;
+            rect = &screen;
+        }
+        batch(NULL);
+        addQuad(rect, color(r, g, b, a));
+    }
+
+    virtual void filledCircle(int x, int y, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        // Triangle fan, flattened to a list so it can share the batch
+        int segments = radius < 8 ? 8 : (radius > 32 ? 32 : radius);
+        SDL_Color c = color(r, g, b, a);
+        batch(NULL);
+
+        int center = addVertex(x, y, c, 0, 0);
+        int i;
+        for( i = 0; i < segments; i++ ) {
+            double angle = (M_PI * 2.0 * i) / segments;
+            addVertex(x + (radius * cos(angle)), y + (radius * sin(angle)), c, 0, 0);
+        }
+        for( i = 0; i < segments; i++ ) {
+            m_indices.push_back(center);
+            m_indices.push_back(center + 1 + i);
+            m_indices.push_back(center + 1 + ((i + 1) % segments));
+        }
+    }
+
+    virtual void filledTrigon(int x1, int y1, int x2, int y2, int x3, int y3, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        SDL_Color c = color(r, g, b, a);
+        batch(NULL);
+        m_indices.push_back(addVertex(x1, y1, c, 0, 0));
+        m_indices.push_back(addVertex(x2, y2, c, 0, 0));
+        m_indices.push_back(addVertex(x3, y3, c, 0, 0));
+    }
+
+    virtual void text(int x, int y, const char *str, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        flush();
+        stringRGBA(m_renderer, x, y, str, r, g, b, a);
+    }
+
+    virtual void blit(SDL_Surface *surface, SDL_Rect *dstrect, bool blend) {
+        SDL_Texture *tex = texture(surface);
+        SDL_BlendMode mode = blend ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE;
+        SDL_BlendMode current;
+        SDL_GetTextureBlendMode(tex, &current);
+        if( current != mode ) {
+            flush();
+            SDL_SetTextureBlendMode(tex, mode);
+        }
+        batch(tex);
+        addQuad(dstrect, color(0xff, 0xff, 0xff, 0xff));
+    }
+
+    virtual void present() {
+        flush();
+        if( m_target ) {
+            // Switching target restores the window's own scale of 1
+            SDL_SetRenderTarget(m_renderer, NULL);
+            SDL_RenderCopy(m_renderer, m_target, NULL, NULL);
+            SDL_RenderPresent(m_renderer);
+            SDL_SetRenderTarget(m_renderer, m_target);
+            SDL_RenderSetScale(m_renderer, m_scale, m_scale);
+        }
+        else {
+            SDL_RenderPresent(m_renderer);
+        }
+    }
+
+    /* Below 1.0 draw into a smaller texture, stretched to the window on present */
+    virtual void setRenderScale(double scale) {
+        flush();
+        if( m_target ) {
+            SDL_SetRenderTarget(m_renderer, NULL);
+            SDL_DestroyTexture(m_target);
+            m_target = NULL;
+        }
+        m_scale = 1.0;
+
+        if( scale < 1.0 ) {
+            m_target = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                         m_width * scale, m_height * scale);
+            if( m_target && SDL_SetRenderTarget(m_renderer, m_target) == 0 ) {
+                // Replace the window contents, opaque clouds leave alpha in the target
+                SDL_SetTextureBlendMode(m_target, SDL_BLENDMODE_NONE);
+                m_scale = scale;
+                SDL_RenderSetScale(m_renderer, m_scale, m_scale);
+            }
+            else if( m_target ) {
+                SDL_DestroyTexture(m_target);
+                m_target = NULL;
+            }
+        }
+    }
+
+    virtual void release(SDL_Surface *surface) {
+        std::map<SDL_Surface*, SDL_Texture*>::iterator it = m_textures.find(surface);
+        if( it != m_textures.end() ) {
+            if( m_batch_texture == it->second ) {
+                flush();
+            }
+            SDL_DestroyTexture(it->second);
+            m_textures.erase(it);
+        }
+    }
+
+    /* The texture may not be in the surface's format, so upload it afresh on next use */
+    virtual void update(SDL_Surface *surface) {
+        release(surface);
+    }
+
+protected:
+    static SDL_Color color(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        SDL_Color c;
+        c.r = r;
+        c.g = g;
+        c.b = b;
+        c.a = a;
+        return c;
+    }
+
+    SDL_Texture *texture(SDL_Surface *surface) {
+        std::map<SDL_Surface*, SDL_Texture*>::iterator it = m_textures.find(surface);
+        if( it != m_textures.end() ) {
+            return it->second;
+        }
+        SDL_Texture *texture = SDL_CreateTextureFromSurface(m_renderer, surface);
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        m_textures[surface] = texture;
+        return texture;
+    }
+
+    /* Switching texture ends the current batch */
+    void batch(SDL_Texture *texture) {
+        if( texture != m_batch_texture ) {
+            flush();
+            m_batch_texture = texture;
+        }
+    }
+
+    void flush() {
+        if( ! m_indices.empty() ) {
+            SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_BLEND);
+            SDL_RenderGeometry(m_renderer, m_batch_texture,
+                               &m_vertices[0], m_vertices.size(),
+                               &m_indices[0], m_indices.size());
+        }
+        m_vertices.clear();
+        m_indices.clear();
+    }
+
+    int addVertex(float x, float y, SDL_Color c, float u, float v) {
+        SDL_Vertex vertex;
+        vertex.position.x = x;
+        vertex.position.y = y;
+        vertex.color = c;
+        vertex.tex_coord.x = u;
+        vertex.tex_coord.y = v;
+        m_vertices.push_back(vertex);
+        return m_vertices.size() - 1;
+    }
+
+    void addQuad(SDL_Rect *rect, SDL_Color c) {
+        int tl = addVertex(rect->x, rect->y, c, 0, 0);
+        int tr = addVertex(rect->x + rect->w, rect->y, c, 1, 0);
+        int br = addVertex(rect->x + rect->w, rect->y + rect->h, c, 1, 1);
+        int bl = addVertex(rect->x, rect->y + rect->h, c, 0, 1);
+        m_indices.push_back(tl);
+        m_indices.push_back(tr);
+        m_indices.push_back(br);
+        m_indices.push_back(tl);
+        m_indices.push_back(br);
+        m_indices.push_back(bl);
+    }
+
+private:
+    SDL_Renderer *m_renderer;
+    std::map<SDL_Surface*, SDL_Texture*> m_textures;
+    SDL_Texture *m_batch_texture;
+    std::vector<SDL_Vertex> m_vertices;
+    std::vector<int> m_indices;
+    SDL_Texture *m_target;
+    double m_scale;
+    int m_width;
+    int m_height;
+};
+#else
+/**
+ * SDL 1.2 software surface, every pixel is pushed by the CPU.
+ */
+class Software_Renderer : public Renderer {
+public:
+    Software_Renderer(SDL_Surface *screen)
+    : m_screen(screen)
+    { }
+
+    virtual int width() {
+        return m_screen->w;
+    }
+
+    virtual int height() {
+        return m_screen->h;
+    }
+
+    virtual void clear(Uint8 r, Uint8 g, Uint8 b) {
+        SDL_FillRect(m_screen, NULL, SDL_MapRGB(m_screen->format, r, g, b));
+    }
+
+    virtual void fillRect(SDL_Rect *rect, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        SDL_FillRect(m_screen, rect, SDL_MapRGBA(m_screen->format, r, g, b, a));
+    }
+
+    virtual void filledCircle(int x, int y, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        filledCircleRGBA(m_screen, x, y, radius, r, g, b, a);
+    }
+
+    virtual void filledTrigon(int x1, int y1, int x2, int y2, int x3, int y3, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        filledTrigonRGBA(m_screen, x1, y1, x2, y2, x3, y3, r, g, b, a);
+    }
+
+    virtual void text(int x, int y, const char *str, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        stringRGBA(m_screen, x, y, str, r, g, b, a);
+    }
+
+    virtual void blit(SDL_Surface *surface, SDL_Rect *dstrect, bool blend) {
+        // Changing SDL_SRCALPHA invalidates the blit map, so only when it differs
+        if( ((surface->flags & SDL_SRCALPHA) != 0) != blend ) {
+            SDL_SetAlpha(surface, blend ? SDL_SRCALPHA : 0, SDL_ALPHA_OPAQUE);
+        }
+        SDL_BlitSurface(surface, &surface->clip_rect, m_screen, dstrect);
+    }
+
+    virtual void present() {
+        SDL_Flip(m_screen);
+    }
+
+private:
+    SDL_Surface *m_screen;
+};
+#endif
+
 class Sprite : public Rect {
 public:
     Sprite(int width, int height)
-    : Rect(0, 0, width, height), m_visible(true), m_surface(NULL)
+    : Rect(0, 0, width, height), m_visible(true), m_blended(true), m_surface(NULL), m_renderer(NULL)
+    , m_pos_x(0), m_pos_y(0), m_delta_x(0), m_delta_y(0)
     {
-        assert(width > 0);
-        assert(height > 0);
-        m_surface = SDL_CreateRGBSurface(SDL_SWSURFACE|SDL_SRCALPHA, width, height,
-                                         32, 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF);
+        m_surface = createSurface(width, height);
+    }
+
+    /* Share a surface, and so one texture, with other sprites drawn the same */
+    Sprite(SDL_Surface *surface)
+    : Rect(0, 0, surface->w, surface->h), m_visible(true), m_blended(true), m_surface(surface), m_renderer(NULL)
+    , m_pos_x(0), m_pos_y(0), m_delta_x(0), m_delta_y(0)
+    {
+        m_surface->refcount++;
     }
 
     virtual ~Sprite() {
+        if( m_renderer && m_surface->refcount == 1 ) {
+            m_renderer->release(m_surface);
+        }
         SDL_FreeSurface(m_surface);
     }
 
+    static SDL_Surface *createSurface(int width, int height) {
+        assert(width > 0);
+        assert(height > 0);
+#ifdef SKYDIVER_SDL2
+        return SDL_CreateRGBSurface(0, width, height,
+                                    32, 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF);
+#else
+        return SDL_CreateRGBSurface(SDL_SWSURFACE|SDL_SRCALPHA, width, height,
+                                    32, 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF);
+#endif
+    }
+
     SDL_Surface *getSurface() {
         return m_surface;
     }
@@ -141,10 +645,77 @@ public:
         return m_visible;
     }
 
-    virtual void draw(SDL_Surface *screen, Rect *viewport) {
+    /* Alpha blend when drawn, or an opaque (cheaper) copy */
+    void setBlended( bool blended ) {
+        m_blended = blended;
+    }
+
+    Fixed exactLeft() {
+        return m_pos_x;
+    }
+
+    Fixed exactTop() {
+        return m_pos_y;
+    }
+
+    /**
+     * Move by way of a sub-pixel position, the integer Rect is the
+     * floor of it. The displacement is remembered for sweep().
+     */
+    void moveTo(Fixed x, Fixed y) {
+        m_delta_x = x - m_pos_x;
+        m_delta_y = y - m_pos_y;
+        m_pos_x = x;
+        m_pos_y = y;
+        Rect::moveTo(x.floor(), y.floor());
+    }
+
+    /* Teleport, without leaving a trail to collide along */
+    void placeAt(Fixed x, Fixed y) {
+        moveTo(x, y);
+        m_delta_x = 0;
+        m_delta_y = 0;
+    }
+
+    /* Cut the last movement short at time 'toi' in [0,1], as if it stopped there */
+    void stopAt(Fixed toi) {
+        Fixed start_x = m_pos_x - m_delta_x;
+        Fixed start_y = m_pos_y - m_delta_y;
+        m_delta_x = m_delta_x * toi;
+        m_delta_y = m_delta_y * toi;
+        m_pos_x = start_x + m_delta_x;
+        m_pos_y = start_y + m_delta_y;
+        Rect::moveTo(m_pos_x.floor(), m_pos_y.floor());
+    }
+
+    /**
+     * Swept AABB test of both sprites over their last movement.
+     * Returns the time of impact in [0,1], or -1 if they never touched.
+     */
+    Fixed sweep(Sprite *B) {
+        Fixed dx = m_delta_x - B->m_delta_x;
+        Fixed dy = m_delta_y - B->m_delta_y;
+        Fixed enter_x, exit_x, enter_y, exit_y;
+
+        if( ! sweepAxis(m_pos_x - m_delta_x, width(), B->m_pos_x - B->m_delta_x, B->width(), dx, &enter_x, &exit_x) ) {
+            return -1;
+        }
+        if( ! sweepAxis(m_pos_y - m_delta_y, height(), B->m_pos_y - B->m_delta_y, B->height(), dy, &enter_y, &exit_y) ) {
+            return -1;
+        }
+
+        Fixed enter = enter_x > enter_y ? enter_x : enter_y;
+        Fixed exit = exit_x < exit_y ? exit_x : exit_y;
+        if( enter >= exit || enter >= 1 || exit <= 0 ) {
+            return -1;
+        }
+        return enter < 0 ? Fixed(0) : enter;
+    }
+
+    virtual void draw(Renderer *renderer, Rect *viewport) {
         if( isVisible() && collidesWith(viewport) ) {
-            assert( viewport->width() == screen->w );
-            assert( viewport->height() == screen->h );
+            assert( viewport->width() == renderer->width() );
+            assert( viewport->height() == renderer->height() );
 
             SDL_Rect dstrect;
             dstrect.x = this->left() - viewport->left();
@@ -152,34 +723,242 @@ public:
             dstrect.w = this->width();
             dstrect.h = this->height();
 
-            SDL_BlitSurface(m_surface, &m_surface->clip_rect, screen, &dstrect);
+            m_renderer = renderer;
+            renderer->blit(m_surface, &dstrect, m_blended);
         }
     }   
 
-protected:  
+protected:
+    /* Entry and exit times of span A moving by 'd' over span B */
+    static bool sweepAxis(Fixed a, Fixed a_len, Fixed b, Fixed b_len, Fixed d, Fixed *enter, Fixed *exit) {
+        if( d == 0 ) {
+            if( a + a_len <= b || a >= b + b_len ) {
+                return false;
+            }
+            *enter = Fixed::min();
+            *exit = Fixed::max();
+        }
+        else if( d > 0 ) {
+            *enter = (b - (a + a_len)) / d;
+            *exit = ((b + b_len) - a) / d;
+        }
+        else {
+            *enter = ((b + b_len) - a) / d;
+            *exit = (b - (a + a_len)) / d;
+        }
+        return true;
+    }
+
     bool m_visible;
+    bool m_blended;
     SDL_Surface *m_surface;
+    Renderer *m_renderer;
+    Fixed m_pos_x, m_pos_y;
+    Fixed m_delta_x, m_delta_y;
 };
 
 
-class Game_State {
+/**
+ * Something a Timer_Wheel can wake up. The links live in the client
+ * itself, so scheduling and cancelling never allocate.
+ */
+class Timer_Client {
+public:
+    Timer_Client()
+    : m_timer_next(NULL), m_timer_pprev(NULL), m_timer_due(0)
+    { }
+
+    virtual ~Timer_Client() {
+        cancelTimer();
+    }
+
+    bool isScheduled() const {
+        return m_timer_pprev != NULL;
+    }
+
+    void cancelTimer() {
+        if( m_timer_pprev ) {
+            *m_timer_pprev = m_timer_next;
+            if( m_timer_next ) {
+                m_timer_next->m_timer_pprev = m_timer_pprev;
+            }
+            m_timer_next = NULL;
+            m_timer_pprev = NULL;
+        }
+    }
+
+    virtual void wake() = 0;
+
+private:
+    friend class Timer_Wheel;
+    Timer_Client *m_timer_next;
+    Timer_Client **m_timer_pprev;
+    uint64_t m_timer_due;
+};
+
+/**
+ * Hierarchical timer wheel with millisecond resolution, each level
+ * covers 64 slots of the one below. Advancing only touches the clients
+ * that are due, plus an occasional cascade of the level above, and jumps
+ * straight over empty slots however long it has been since the last call.
+ */
+class Timer_Wheel {
+public:
+    Timer_Wheel(uint64_t now)
+    : m_now(now)
+    {
+        memset(m_slots, 0, sizeof(m_slots));
+        memset(m_occupied, 0, sizeof(m_occupied));
+    }
+
+    ~Timer_Wheel() {
+        int level, index;
+        for( level = 0; level < LEVELS; level++ ) {
+            for( index = 0; index < SLOTS; index++ ) {
+                while( m_slots[level][index] ) {
+                    m_slots[level][index]->cancelTimer();
+                }
+            }
+        }
+    }
+
+    uint64_t now() const {
+        return m_now;
+    }
+
+    /* (Re)schedule the client to wake in 'delay' milliseconds, at least 1 */
+    void schedule(Timer_Client *client, uint64_t delay) {
+        client->cancelTimer();
+        client->m_timer_due = m_now + (delay ? delay : 1);
+        insert(client);
+    }
+
+    void advance(uint64_t now) {
+        while( m_now < now ) {
+            // Straight to the next slot which is due or cascades, or to 'now'
+            uint64_t next = now;
+            int level;
+            for( level = 0; level < LEVELS; level++ ) {
+                uint64_t when = nextSlot(level);
+                if( when && when < next ) {
+                    next = when;
+                }
+            }
+            m_now = next;
+
+            int index = m_now & SLOT_MASK;
+            if( ! index ) {
+                cascade(1);
+            }
+
+            Timer_Client *client;
+            while( (client = m_slots[0][index]) ) {
+                client->cancelTimer();
+                client->wake();
+            }
+            m_occupied[0] &= ~(1ULL << index);
+        }
+    }
+
+private:
+    void insert(Timer_Client *client) {
+        uint64_t due = client->m_timer_due < m_now ? m_now : client->m_timer_due;
+        uint64_t delta = due - m_now;
+        int level = 0;
+        while( level < LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1))) ) {
+            level++;
+        }
+
+        // Beyond the top level, park in its furthest slot and re-cascade
+        uint64_t span = 1ULL << (SLOT_BITS * LEVELS);
+        if( delta >= span ) {
+            due = m_now + span - 1;
+        }
+
+        Timer_Client **head = &m_slots[level][(due >> (SLOT_BITS * level)) & SLOT_MASK];
+        client->m_timer_next = *head;
+        if( *head ) {
+            (*head)->m_timer_pprev = &client->m_timer_next;
+        }
+        client->m_timer_pprev = head;
+        *head = client;
+        m_occupied[level] |= 1ULL << (head - m_slots[level]);
+    }
+
+    /**
+     * Time of the first occupied slot of 'level' after m_now, or 0 if it
+     * has none. Level 0 slots are due then, higher levels cascade then.
+     */
+    uint64_t nextSlot(int level) {
+        int shift = SLOT_BITS * level;
+        uint64_t base = (m_now >> shift) + 1;
+        int start = base & SLOT_MASK;
+        while( m_occupied[level] ) {
+            // Rotate so bit 0 is the slot at 'base'
+            uint64_t bits = m_occupied[level];
+            if( start ) {
+                bits = (bits >> start) | (bits << (SLOTS - start));
+            }
+            int skip = __builtin_ctzll(bits);
+            int index = (start + skip) & SLOT_MASK;
+            if( m_slots[level][index] ) {
+                return (base + skip) << shift;
+            }
+            // Emptied by cancelTimer(), which can't see the bitmap
+            m_occupied[level] &= ~(1ULL << index);
+        }
+        return 0;
+    }
+
+    /* Redistribute the current slot of 'level' into the levels below */
+    void cascade(int level) {
+        int index = (m_now >> (SLOT_BITS * level)) & SLOT_MASK;
+        Timer_Client *client = m_slots[level][index];
+        m_slots[level][index] = NULL;
+        m_occupied[level] &= ~(1ULL << index);
+        while( client ) {
+            Timer_Client *next = client->m_timer_next;
+            client->m_timer_next = NULL;
+            client->m_timer_pprev = NULL;
+            insert(client);
+            client = next;
+        }
+
+        if( ! index && level + 1 < LEVELS ) {
+            cascade(level + 1);
+        }
+    }
+
+    static const int LEVELS = 5;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const int SLOT_MASK = SLOTS - 1;
+
+    uint64_t m_now;
+    Timer_Client *m_slots[LEVELS][SLOTS];
+    uint64_t m_occupied[LEVELS];    // Bit per slot which may have clients
+};
+
+class Game_State : public Timer_Client {
 public:
     Game_State()
-    : m_event(NULL), m_now(0.0), m_score(0), m_coins(0)
+    : m_event(NULL), m_now(0.0), m_millis(0), m_score(0), m_coins(0)
     , m_chain_expire(0.0), m_chain_time(1.1), m_next_wave(0.0), m_wave(0)
+    , m_wave_start(0), m_timers(NULL)
     { }
 
     void think(SDL_Event *event) {        
         m_event = event;
         m_now = millitime();
-        if( m_chain_expire < m_now ) {
-            m_chain_expire = m_now;
-        }
+        m_millis = m_now * 1000;
+    }
 
-        if( m_next_wave <= m_now ) {
-            m_next_wave = m_now + WAVE_DURATION;
-            m_wave++;
-        }
+    /* Wave timer */
+    virtual void wake() {
+        m_next_wave = m_now + WAVE_DURATION;
+        m_wave_start = m_millis;
+        m_wave++;
+        m_timers->schedule(this, WAVE_DURATION * 1000);
     }
 
     bool isCoinChained() const {
@@ -187,6 +966,9 @@ public:
     }
 
     bool collectCoin() {
+        if( m_chain_expire < m_now ) {
+            m_chain_expire = m_now;
+        }
         m_chain_expire += m_chain_time;
         m_score += 1 * coinMultiplier();
 
@@ -204,6 +986,11 @@ public:
         return m_now;
     }
 
+    /* now() in whole milliseconds, for the integer physics */
+    uint64_t millis() const {
+        return m_millis;
+    }
+
     int score() const {
         return m_score;
     }
@@ -224,6 +1011,10 @@ public:
         return WAVE_DURATION - waveTimeRemaining();
     }
 
+    uint64_t waveMillisSoFar() const {
+        return m_millis - m_wave_start;
+    }
+
     int wave() const {
         return m_wave;
     }
@@ -236,9 +1027,18 @@ public:
         return m_event;
     }
 
+    Timer_Wheel *timers() {
+        return m_timers;
+    }
+
+    Timer_Wheel *timers(Timer_Wheel *timers) {
+        return m_timers = timers;
+    }
+
 protected:
     SDL_Event *m_event;
     double m_now;
+    uint64_t m_millis;
     int m_score;
     int m_coins;
     double m_chain_expire;
@@ -246,11 +1046,13 @@ protected:
     Rect m_viewport;
     double m_next_wave;
     int m_wave;
+    uint64_t m_wave_start;
+    Timer_Wheel *m_timers;
 
     static const int WAVE_DURATION = 8;
 };
 
-class Game_Entity {
+class Game_Entity : public Timer_Client {
 public:
     Game_Entity() {}
     virtual ~Game_Entity() {
@@ -258,19 +1060,97 @@ public:
     }
     virtual void reset(Game_State *state) = 0;
     virtual void think(Game_State *state) = 0;
+    virtual void wake() {}
+};
+
+/**
+ * Entities whose activity bounds overlap the margin around the viewport
+ * are stepped each tick. The rest are parked either side of it, sorted
+ * by their nearest edge, so waking them as the viewport scrolls only
+ * looks at the ones the margin has reached.
+ *
+ * T provides activityBounds(), everywhere it can be until its next
+ * reset, and fastForward() to catch up analytically when woken.
+ */
+template <class T>
+class Activity_Set {
+public:
+    typedef std::multimap<int, T*> Parked;
+
+    void add(T *entity) {
+        m_active.push_back(entity);
+    }
+
+    std::vector<T*> &active() {
+        return m_active;
+    }
+
+    void update(Game_State *state, Rect *margin) {
+        size_t i = 0;
+        while( i < m_active.size() ) {
+            if( park(m_active[i], margin) ) {
+                m_active[i] = m_active.back();
+                m_active.pop_back();
+            }
+            else {
+                i++;
+            }
+        }
+
+        T *entity;
+        while( ! m_right.empty() && m_right.begin()->first < margin->right() ) {
+            entity = m_right.begin()->second;
+            m_right.erase(m_right.begin());
+            if( ! park(entity, margin) ) {
+                activate(state, entity);
+            }
+        }
+
+        while( ! m_left.empty() && (--m_left.end())->first > margin->left() ) {
+            entity = (--m_left.end())->second;
+            m_left.erase(--m_left.end());
+            if( ! park(entity, margin) ) {
+                activate(state, entity);
+            }
+        }
+    }
+
+private:
+    /* Only horizontal, the viewport never scrolls vertically */
+    bool park(T *entity, Rect *margin) {
+        Rect bounds = entity->activityBounds();
+        if( bounds.right() <= margin->left() ) {
+            m_left.insert(typename Parked::value_type(bounds.right(), entity));
+            return true;
+        }
+        if( bounds.left() >= margin->right() ) {
+            m_right.insert(typename Parked::value_type(bounds.left(), entity));
+            return true;
+        }
+        return false;
+    }
+
+    void activate(Game_State *state, T *entity) {
+        entity->fastForward(state);
+        m_active.push_back(entity);
+    }
+
+    std::vector<T*> m_active;
+    Parked m_left;
+    Parked m_right;
 };
 
 
 class Cloud_Sprite : public Sprite, public Game_Entity {
 public:
     Cloud_Sprite(int width, int height)
-    : Sprite(width, height), m_sleep(0), m_velocity(0)
+    : Sprite(width, height), m_velocity(0)
     {
         SDL_Surface *surface = getSurface();
         SDL_FillRect(surface, NULL, SDL_MapRGBA(surface->format, 0xff, 0xff, 0xff, 0xC0));
     }
 
-    int velocity() { 
+    Fixed velocity() { 
         return m_velocity;
     }
     
@@ -281,10 +1161,10 @@ public:
         int pos_x;
 
         setVisible(false);
-        m_sleep = random() % 60;
-        m_velocity = 1 + (random() % 6);
+        uint64_t sleep = (random() % 60) * (1000 / GLOBAL_FPS);
+        m_velocity = Fixed(1 + (int)(random() % 6));
         if( random() % 2 ) {
-            m_velocity = 0 - m_velocity;
+            m_velocity = -m_velocity;
         }
 
         if( m_velocity > 0 ) {
@@ -295,55 +1175,57 @@ public:
         }
 
         int pos_y = (viewport->height()/2) + (random() % ((viewport->height()/2) - cloud_height));
-        moveTo(pos_x, pos_y);
+        placeAt(pos_x, pos_y);
+        state->timers()->schedule(this, sleep);
     }
 
-    virtual void think(Game_State *state) {
-        m_sleep--;
-        if( m_sleep > 0 ) {
-            return;
-        }
-        else if( m_sleep == 0 ) {
-            setVisible(true);
-        }
+    virtual void wake() {
+        setVisible(true);
+    }
 
-        moveTo(left() + m_velocity, top());
+    virtual void think(Game_State *state) {
+        moveTo(exactLeft() + m_velocity, exactTop());
         if( ! collidesWith(state->viewport()) ) {
             reset(state);
         }    
     }
 
 protected:
-    int m_sleep;
-    int m_velocity;
+    Fixed m_velocity;
 };
 
 class Coin_Sprite : public Sprite, public Game_Entity {
 public:
     Coin_Sprite(int size)
-    : Sprite(size, size), Game_Entity(), m_target_x(10), m_target_y(10)
-    {
-        SDL_Surface *surface = getSurface();
+    : Sprite(sharedSurface(size)), Game_Entity(), m_target_x(10), m_target_y(10)
+    , m_radius(Fixed::fromRatio(size * 2, 7)), m_phase(0)
+    { }
+
+    /**
+     * Every coin looks the same, so they share one surface and the
+     * renderer can draw them all in one batch. The class keeps its own
+     * reference, one per size and never freed, so the texture outlives
+     * any one scene's coins and a cached texture never goes stale.
+     */
+    static SDL_Surface *sharedSurface(int size) {
+        static std::map<int, SDL_Surface*> surfaces;
+        std::map<int, SDL_Surface*>::iterator it = surfaces.find(size);
+        if( it != surfaces.end() ) {
+            return it->second;
+        }
+
+        SDL_Surface *surface = createSurface(size, size);
+        surfaces[size] = surface;
         int half_w = surface->w / 2;
         int half_h = surface->h / 2;
         SDL_FillRect(surface, NULL, SDL_MapRGBA(surface->format, 0xff, 0xff, 0xff, 0x00));
-        filledEllipseRGBA(surface, half_w, half_h, half_w - 2 , half_h - 2, 0xFB, 0xB9, 0x17, 0xE0);
+        surfaceFilledEllipse(surface, half_w, half_h, half_w - 2 , half_h - 2, 0xFB, 0xB9, 0x17, 0xE0);
+        return surface;
     }
 
     virtual void think(Game_State *state) {
-        double tsf = state->waveTimeSoFar();
-        Rect *viewport = state->viewport();
-        
-        double v = m_target_x+state->now() * 2.5;
-        int pos_x, pos_y;
-        if( m_target_x % 2 ) {            
-            pos_x = m_target_x + ((width()/3.5) * sin(v+tsf));
-            pos_y = m_target_y + ((width()/3.5) * cos(v));
-        }
-        else {
-            pos_x = m_target_x + ((width()/3.5) * cos(v+tsf));
-            pos_y = m_target_y + ((width()/3.5) * sin(v));
-        }
+        Fixed pos_x, pos_y;
+        orbit(state, &pos_x, &pos_y);
         moveTo(pos_x, pos_y);
     }
 
@@ -352,32 +1234,67 @@ public:
         m_target_x = viewport->left() + (random() % (viewport->width() - width()));
         m_target_y = viewport->top() + (random() % (viewport->height()/3*2));                
         setVisible(true);
+
+        // m_target_x radians, in ANGLE_CIRCLE units (Q16)
+        m_phase = ((int64_t)m_target_x * 10680707) >> 16;
+
+        fastForward(state);
+    }
+
+    /* Position is a closed-form function of time, so just jump there */
+    void fastForward(Game_State *state) {
+        Fixed pos_x, pos_y;
+        orbit(state, &pos_x, &pos_y);
+        placeAt(pos_x, pos_y);
+    }
+
+    Rect activityBounds() {
+        int radius = m_radius.ceil();
+        return Rect(m_target_x - radius, m_target_y - radius,
+                    width() + (radius * 2), height() + (radius * 2));
     }
+
 private:
+    void orbit(Game_State *state, Fixed *pos_x, Fixed *pos_y) {
+        // 2.5 radians/second and 1 radian/second of wave, as Q16 per millisecond
+        int v = m_phase + ((state->millis() * 26702) >> 16);
+        int tsf = (state->waveMillisSoFar() * 10681) >> 16;
+        if( m_target_x % 2 ) {            
+            *pos_x = Fixed(m_target_x) + (m_radius * fixedSin(v+tsf));
+            *pos_y = Fixed(m_target_y) + (m_radius * fixedCos(v));
+        }
+        else {
+            *pos_x = Fixed(m_target_x) + (m_radius * fixedCos(v+tsf));
+            *pos_y = Fixed(m_target_y) + (m_radius * fixedSin(v));
+        }
+    }
+
     int m_target_x;
     int m_target_y;
+    Fixed m_radius;
+    int m_phase;
 };
 
 class Diver_Sprite : public Sprite, public Game_Entity {
 public:
     Diver_Sprite(int size)
     : Sprite(size, size), Game_Entity()
-    , MOVE_RATE(1.2), m_velocity_x(0.0), m_velocity_y(-0.1)
+    , MOVE_RATE(Fixed::fromRatio(6, 5)), m_velocity_x(0), m_velocity_y(Fixed::fromRatio(-1, 10))
     {
         SDL_Surface *surface = getSurface();
         SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 0x00, 0x00, 0xff));
     }
 
     bool isFalling() {
-        return m_velocity_y < 0.0;
+        return m_velocity_y < 0;
     }
 
     void moveLeft() {
-        m_velocity_x -= MOVE_RATE * 2.5;       
+        m_velocity_x -= MOVE_RATE * Fixed::fromRatio(5, 2);       
     }
 
     void moveRight() {
-        m_velocity_x += MOVE_RATE * 2.5;
+        m_velocity_x += MOVE_RATE * Fixed::fromRatio(5, 2);
     }
 
     void bounceUp() {
@@ -389,11 +1306,11 @@ public:
     }
 
     void bounceLeft() {
-        m_velocity_x = 0 - (MOVE_RATE * 20.0);
+        m_velocity_x = -(MOVE_RATE * 20);
     }
 
     void bounceRight() {
-        m_velocity_x = (MOVE_RATE * 20.0);
+        m_velocity_x = (MOVE_RATE * 20);
     }
 
     virtual void reset(Game_State *state) {
@@ -401,6 +1318,16 @@ public:
     }
 
     virtual void think(Game_State *state) {
+#ifdef SKYDIVER_SDL2
+        // No SDL_EnableKeyRepeat() in SDL2, and the OS repeat is too slow to start
+        const Uint8 *keys = SDL_GetKeyboardState(NULL);
+        if( keys[SDL_SCANCODE_LEFT] ) {
+            moveLeft();
+        }
+        else if( keys[SDL_SCANCODE_RIGHT] ) {
+            moveRight();
+        }
+#else
         SDL_Event *event = state->event();
         if( event && event->type == SDL_KEYDOWN ) {
             SDL_KeyboardEvent *key = &event->key;
@@ -411,12 +1338,13 @@ public:
                 moveRight();
             }            
         }
+#endif
 
         Rect *viewport = state->viewport();
         m_velocity_x /= MOVE_RATE;
         m_velocity_y -= MOVE_RATE;
         
-        moveTo(left() + m_velocity_x, top() - m_velocity_y);
+        moveTo(exactLeft() + m_velocity_x, exactTop() - m_velocity_y);
 
         if( bottom() > viewport->bottom() ) {
             smallBounceUp();
@@ -434,29 +1362,207 @@ public:
     }
 
     /* Display 'position arrow' when Dan is off screen */
-    virtual void draw(SDL_Surface *screen, Rect *viewport) {
+    virtual void draw(Renderer *renderer, Rect *viewport) {
         if( top() < viewport->top() ) {
-            int width = screen->w / 40;
+            int width = renderer->width() / 40;
             int height = width / 2;
             int center = horizontalCenter();
             int left = center - (width / 2);
             int right = center + (width / 2);
-            filledTrigonRGBA(screen, left, height, right, height, center, 0, 0xff, 0xff, 0xff, 0xc0);
+            renderer->filledTrigon(left, height, right, height, center, 0, 0xff, 0xff, 0xff, 0xc0);
         }
 
-        Sprite::draw(screen, viewport);
+        Sprite::draw(renderer, viewport);
     }
 
 public:
-    double MOVE_RATE;
-    double m_velocity_x;
-    double m_velocity_y;
+    Fixed MOVE_RATE;
+    Fixed m_velocity_x;
+    Fixed m_velocity_y;
+};
+
+/**
+ * Knobs the Quality_Governor turns, each level in QUALITY_LEVELS is
+ * cheaper to draw than the one after it.
+ */
+struct Quality {
+    double render_scale;    // Fraction of the window resolution drawn at
+    int particle_detail;    // Intro: 0 static boxes, 1 animated boxes, 2 sparkles
+    bool cloud_alpha;       // Translucent clouds, otherwise opaque blits
+    int hud_interval;       // Frames between HUD refreshes
+};
+
+static const Quality QUALITY_LEVELS[] = {
+    { 0.5,  0, false, 6 },
+    { 0.75, 1, false, 3 },
+    { 1.0,  1, true,  2 },
+    { 1.0,  2, true,  1 },
+};
+static const int QUALITY_LEVEL_COUNT = sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]);
+
+/**
+ * Watches the recent frame times and steps the quality level to hold
+ * the target frame rate. Stepping down needs most of the window's frames
+ * to be over budget, so one long frame can't trigger it. Stepping up
+ * needs a much longer run of fast averages, so it doesn't oscillate
+ * between two levels.
+ */
+class Quality_Governor {
+public:
+    Quality_Governor(double target_fps)
+    : m_target(1.0 / target_fps), m_level(QUALITY_LEVEL_COUNT - 1)
+    , m_steps_up(0), m_steps_down(0), m_frames(0), m_total(0.0)
+    , m_slow_frames(0), m_fast_streak(0)
+    {
+        memset(m_samples, 0, sizeof(m_samples));
+    }
+
+    /* Record the time one frame took to produce, returns true if the level changed */
+    bool frame(double seconds) {
+        double *sample = &m_samples[m_frames % WINDOW];
+        m_total -= *sample;
+        m_slow_frames -= isSlow(*sample);
+        *sample = seconds;
+        m_total += seconds;
+        m_slow_frames += isSlow(seconds);
+        m_frames++;
+        if( m_frames < WINDOW ) {
+            return false;
+        }
+
+        double average = averageFrameTime();
+        m_fast_streak = average * 100 < m_target * FAST_PERCENT ? m_fast_streak + 1 : 0;
+
+        if( m_slow_frames >= SLOW_FRAMES && m_level > 0 ) {
+            m_level--;
+            m_steps_down++;
+            restart();
+            return true;
+        }
+        if( m_fast_streak >= FAST_FRAMES && m_level < QUALITY_LEVEL_COUNT - 1 ) {
+            m_level++;
+            m_steps_up++;
+            restart();
+            return true;
+        }
+        return false;
+    }
+
+    const Quality &quality() const {
+        return QUALITY_LEVELS[m_level];
+    }
+
+    int level() const {
+        return m_level;
+    }
+
+    int stepsUp() const {
+        return m_steps_up;
+    }
+
+    int stepsDown() const {
+        return m_steps_down;
+    }
+
+    double averageFrameTime() const {
+        size_t count = m_frames;
+        if( count > WINDOW ) {
+            count = WINDOW;
+        }
+        return count ? m_total / count : 0.0;
+    }
+
+private:
+    bool isSlow(double seconds) const {
+        return seconds * 100 > m_target * SLOW_PERCENT;
+    }
+
+    /* Judge the new level on its own frames only */
+    void restart() {
+        m_frames = 0;
+        m_total = 0.0;
+        m_slow_frames = 0;
+        m_fast_streak = 0;
+        memset(m_samples, 0, sizeof(m_samples));
+    }
+
+    static const size_t WINDOW = 30;
+    static const int SLOW_FRAMES = 20;     // Of the last WINDOW
+    static const int FAST_FRAMES = 90;
+    static const int SLOW_PERCENT = 105;
+    static const int FAST_PERCENT = 60;
+
+    double m_target;
+    int m_level;
+    int m_steps_up;
+    int m_steps_down;
+    size_t m_frames;
+    double m_samples[WINDOW];
+    double m_total;
+    int m_slow_frames;
+    int m_fast_streak;
+};
+
+/**
+ * Score and bars, the bars are painted into a surface only when sampled
+ * so the frames in between are a single blit. The score is drawn by the
+ * screen's renderer every frame, SDL2_gfx caches its glyphs per renderer.
+ */
+class Hud_Sprite : public Sprite {
+public:
+    Hud_Sprite(int width, int height)
+    : Sprite(width, height)
+    {
+        m_score[0] = '\0';
+    }
+
+    void paint(const char *score, bool show_multiplier, int multiplier_width, int wave_width) {
+        snprintf(m_score, sizeof(m_score), "%s", score);
+
+        SDL_Surface *surface = getSurface();
+        SDL_FillRect(surface, NULL, SDL_MapRGBA(surface->format, 0x00, 0x00, 0x00, 0x00));
+
+        SDL_Rect multirect;
+        if( show_multiplier ) {            
+            multirect.x = 0;
+            multirect.y = 15;
+            multirect.h = 5;
+            multirect.w = multiplier_width;
+            int red = (multirect.w / 100.0) * 0xff;
+            int green = (1.0 - (multirect.w / 100.0)) * 0xff;
+            SDL_FillRect(surface, &multirect, SDL_MapRGBA(surface->format, red, green, 0x00, 0xC0));
+        }
+
+        multirect.x = 0;
+        multirect.y = 30;
+        multirect.h = 5;
+        multirect.w = wave_width < 0 ? 0 : wave_width;
+        int red = (1.0 - (multirect.w / 100.0)) * 0xff;
+        int blue = (multirect.w / 100.0) * 0xff;
+        SDL_FillRect(surface, &multirect, SDL_MapRGBA(surface->format, red, 0x00, blue, 0xC0));
+
+        if( m_renderer ) {
+            m_renderer->update(surface);
+        }
+    }
+
+    /* The HUD is placed in screen coordinates, not the world's */
+    void drawOnScreen(Renderer *renderer) {
+        SDL_Rect dstrect = getSDL_Rect();
+        m_renderer = renderer;
+        renderer->blit(m_surface, &dstrect, true);
+        renderer->text(left(), top(), m_score, 0, 0, 0, 0xff);
+    }
+
+private:
+    char m_score[30];
 };
 
 class Scene {
 protected:
     Scene(int width, int height)
     : m_width(width), m_height(height)
+    , m_quality(QUALITY_LEVELS[QUALITY_LEVEL_COUNT - 1])
     {}
 
 public:
@@ -467,20 +1573,41 @@ public:
     int height() {
         return m_height;
     }
+
+    const Quality &quality() const {
+        return m_quality;
+    }
+
+    virtual void setQuality(const Quality &quality) {
+        m_quality = quality;
+    }
+
+    /**
+     * millitime() at which the scene next changes by itself: 0.0 while it
+     * animates every frame, HUGE_VAL when only input will change it.
+     */
+    virtual double idleUntil() {
+        return 0.0;
+    }
+
     virtual ~Scene() {}
     virtual void think(SDL_Event *state) = 0;
-    virtual void draw(SDL_Surface *screen) = 0;
+    virtual void draw(Renderer *renderer) = 0;
 
 private:
     int m_width;
     int m_height;
+    Quality m_quality;
 };
 
 class Game_Scene : public Scene {
 public:
     Game_Scene(int width, int height)
-    : Scene(width, height), m_wave(-1)
+    : Scene(width, height), m_timers(millitime() * 1000), m_wave(-1), m_hud_frame(0)
     {
+        m_state.timers(&m_timers);
+        m_timers.schedule(&m_state, 0);
+
         Rect *viewport = m_state.viewport();
         viewport->left(0);
         viewport->top(0);
@@ -499,17 +1626,22 @@ public:
         for( i = 0; i < COIN_COUNT; i++ ) {
             m_coins[i] = new Coin_Sprite(coin_size);
             m_coins[i]->reset(&m_state);
+            m_coin_activity.add(m_coins[i]);
         }
 
         int diver_width = width / 20;
         m_diver = new Diver_Sprite(diver_width);
-        m_diver->moveTo(width/2-(diver_width/2), height/2-(diver_width/2));
+        m_diver->placeAt(width/2-(diver_width/2), height/2-(diver_width/2));
+
+        m_hud = new Hud_Sprite(200, 40);
+        m_hud->placeAt(10, 10);
     }
 
     virtual ~Game_Scene() {
         size_t i;
 
         delete m_diver;
+        delete m_hud;
 
         for( i = 0; i < CLOUD_COUNT; i++ ) {
             if( m_clouds[i] ) {
@@ -526,106 +1658,136 @@ public:
 
     void moveViewport() {
         Rect *viewport = m_state.viewport();
-        double viewport_distance = (m_diver->horizontalCenter() - viewport->horizontalCenter());
-        int mod = (viewport_distance / 40.3);
+        int viewport_distance = (m_diver->horizontalCenter() - viewport->horizontalCenter());
+        int mod = (viewport_distance * 10) / 403;
         viewport->left( viewport->left() + mod );
     }
 
+    /* Entities outside this are parked, wide enough to cover a bouncing diver */
+    Rect activityMargin() {
+        Rect *viewport = m_state.viewport();
+        int margin = viewport->width() / 4;
+        return Rect(viewport->left() - margin, viewport->top() - viewport->height(),
+                    viewport->width() + (margin * 2), viewport->height() * 3);
+    }
+
     virtual void think(SDL_Event *event) {    
         m_state.think(event);      
+        m_timers.advance(m_state.millis());
         m_diver->think(&m_state);  
         moveViewport();
 
+        Rect margin = activityMargin();
+        m_coin_activity.update(&m_state, &margin);
+
+        // Step everything first, so each sweep compares movements over the same tick
         size_t i;
-        bool cloud_collide = false;
         for( i = 0; i < CLOUD_COUNT; i++ ) {
-            if( m_clouds[i] ) {
-                if( ! cloud_collide && m_diver->isFalling() && m_clouds[i]->isVisible() && m_clouds[i]->collidesWith(m_diver) ) {
-                    m_diver->bounceUp();                    
-                    cloud_collide = true;
-                }
+            // Sleeping clouds are hidden until their timer wakes them
+            if( m_clouds[i] && m_clouds[i]->isVisible() ) {
                 m_clouds[i]->think(&m_state);
             }
         }
 
-        for( i = 0; i < COIN_COUNT; i++ ) {
-            if( m_coins[i] ) {
-                if( m_coins[i]->isVisible() && m_coins[i]->collidesWith(m_diver) ) {
-                    m_coins[i]->reset(&m_state);
-                    m_state.collectCoin();
+        std::vector<Coin_Sprite*> &coins = m_coin_activity.active();
+        for( i = 0; i < coins.size(); i++ ) {
+            coins[i]->think(&m_state);
+        }
+
+        if( m_diver->isFalling() ) {
+            Fixed landed = -1;
+            for( i = 0; i < CLOUD_COUNT; i++ ) {
+                if( m_clouds[i] && m_clouds[i]->isVisible() ) {
+                    Fixed toi = m_diver->sweep(m_clouds[i]);
+                    if( toi >= 0 && (landed < 0 || toi < landed) ) {
+                        landed = toi;
+                    }
                 }
-                m_coins[i]->think(&m_state);
+            }
+
+            // Bounce from the first cloud touched, not from wherever the tick ended
+            if( landed >= 0 ) {
+                m_diver->stopAt(landed);
+                m_diver->bounceUp();
+            }
+        }
+
+        for( i = 0; i < coins.size(); i++ ) {
+            if( coins[i]->isVisible() && m_diver->sweep(coins[i]) >= 0 ) {
+                coins[i]->reset(&m_state);
+                m_state.collectCoin();
             }
         }        
     }
 
-    virtual void drawScore(SDL_Surface *screen) {
+    virtual void setQuality(const Quality &quality) {
+        Scene::setQuality(quality);
+        for( size_t i = 0; i < CLOUD_COUNT; i++ ) {
+            if( m_clouds[i] ) {
+                m_clouds[i]->setBlended(quality.cloud_alpha);
+            }
+        }
+    }
+
+    /* Sample the HUD values and repaint it, drawScore() blits it in between */
+    void updateScore() {
         char score_txt[30];
         sprintf(score_txt, "%d points", m_state.score());
-        stringRGBA (screen, 10, 10, score_txt, 0, 0, 0, 0xff);
 
-        bool show_multiplier;
+        bool show_multiplier = false;
         if( m_state.coinMultiplier() < 8.0 ) show_multiplier = true;
         else if( (int)((m_state.now() - (int)m_state.now()) * 10.0) % 2 ) show_multiplier = true;
 
-        SDL_Rect multirect;
-        if( show_multiplier ) {            
-            multirect.x = 10;
-            multirect.y = 25;
-            multirect.h = 5;
-            multirect.w = m_state.coinMultiplier() * 10;
-            int red = (multirect.w / 100.0) * 0xff;
-            int green = (1.0 - (multirect.w / 100.0)) * 0xff;
-            SDL_FillRect(screen, &multirect, SDL_MapRGBA(screen->format, red, green, 0x00, 0xC0));
-        }
+        m_hud->paint(score_txt, show_multiplier,
+                     m_state.coinMultiplier() * 10,
+                     (m_state.waveTimeRemaining() / m_state.waveDuration()) * 100);
+    }
 
-        multirect.x = 10;
-        multirect.y = 40;
-        multirect.h = 5;
-        multirect.w = (m_state.waveTimeRemaining() / m_state.waveDuration()) * 100;
-        int red = (1.0 - (multirect.w / 100.0)) * 0xff;
-        int blue = (multirect.w / 100.0) * 0xff;
-        SDL_FillRect(screen, &multirect, SDL_MapRGBA(screen->format, red, 0x00, blue, 0xC0));
+    virtual void drawScore(Renderer *renderer) {
+        if( m_hud_frame++ % quality().hud_interval == 0 ) {
+            updateScore();
+        }
+        m_hud->drawOnScreen(renderer);
     }
 
-    void drawBackground(SDL_Surface *screen) {
-        size_t distance = screen->w / 15;
+    void drawBackground(Renderer *renderer) {
+        size_t distance = renderer->width() / 15;
         size_t i = distance;        
         SDL_Rect box;
         box.y = 0;
         box.w = 5;
-        box.h = screen->h;
+        box.h = renderer->height();
         size_t start = m_state.viewport()->left() % distance;
 
-        SDL_FillRect(screen, NULL, SDL_MapRGB(screen->format, 0x00, 0x56, 0xaf));        
+        renderer->clear(0x00, 0x56, 0xaf);        
         
         while( i-- ) {
             box.x = start;
             start += distance;
-            SDL_FillRect(screen, &box, SDL_MapRGB(screen->format, 0x00, 0x56, 0xa0));
+            renderer->fillRect(&box, 0x00, 0x56, 0xa0, 0xff);
         }
     }
 
-    virtual void draw(SDL_Surface *screen) {
+    virtual void draw(Renderer *renderer) {
         size_t i;        
         Rect *viewport = m_state.viewport();
-        drawBackground(screen);
-        for( i = 0; i < COIN_COUNT; i++ ) {
-            if( m_coins[i] ) {
-                m_coins[i]->draw(screen, viewport);
-            }
+        drawBackground(renderer);
+        std::vector<Coin_Sprite*> &coins = m_coin_activity.active();
+        for( i = 0; i < coins.size(); i++ ) {
+            coins[i]->draw(renderer, viewport);
         }
         for( i = 0; i < CLOUD_COUNT; i++ ) {
             if( m_clouds[i] ) {
-                m_clouds[i]->draw(screen, viewport);
+                m_clouds[i]->draw(renderer, viewport);
             }
         }        
-        m_diver->draw(screen, viewport);        
+        m_diver->draw(renderer, viewport);        
 
-        drawScore(screen);
+        drawScore(renderer);
     }
 
 public:
+    Timer_Wheel m_timers;
     Game_State m_state;
 
     static const size_t CLOUD_COUNT = 4;
@@ -633,10 +1795,14 @@ public:
 
     static const size_t COIN_COUNT = 10;
     Coin_Sprite *m_coins[COIN_COUNT];
+    Activity_Set<Coin_Sprite> m_coin_activity;
 
     Diver_Sprite *m_diver;
 
     int m_wave;
+
+    Hud_Sprite *m_hud;
+    int m_hud_frame;
 };
 
 class Intro_Scene : public Scene {
@@ -668,7 +1834,15 @@ public:
 
     }
 
-    virtual void draw(SDL_Surface *screen) {
+    /* Faded in with the particles at their flat, static detail */
+    virtual double idleUntil() {
+        if( m_opacity >= 1.0 && quality().particle_detail == 0 ) {
+            return HUGE_VAL;
+        }
+        return 0.0;
+    }
+
+    virtual void draw(Renderer *renderer) {
         int box_width, box_height;
         int origin_x, origin_y;     
         int rows, cols;
@@ -684,33 +1858,52 @@ public:
         cols = sizeof(intro_logo[0]) / sizeof(intro_logo[0][0]);
         rows = sizeof(intro_logo) / sizeof(intro_logo[0]);
 
-        box_height = box_width = screen->w / (cols*2);
-        origin_x = (screen->w / 2) - ((cols * box_width) / 2);
-        origin_y = (screen->h / 2) - ((rows * box_height) / 2);
+        box_height = box_width = renderer->width() / (cols*2);
+        origin_x = (renderer->width() / 2) - ((cols * box_width) / 2);
+        origin_y = (renderer->height() / 2) - ((rows * box_height) / 2);
 
         /* Oooo, sinewave sparkles! */
         int x, y;
-        SDL_FillRect(screen, NULL, SDL_MapRGB(screen->format, 10, 10, 10));
+        renderer->clear(10, 10, 10);
         for( x = 0; x < cols; x++ ) {
             for( y = 0; y < rows; y++ ) {
                 bool show_box = intro_logo[y][x] > 0;
                 if( show_box ) {
+                    int pos_x = origin_x + (x * box_width + (box_width/2));
+                    int pos_y = origin_y + (y * box_width + (box_width/2));
+
+                    /* Lowest detail is a flat logo, no trig at all */
+                    if( quality().particle_detail == 0 ) {
+                        SDL_Rect box;
+                        box.x = pos_x - (box_width/4);
+                        box.y = pos_y - (box_width/4);
+                        box.w = box.h = box_width/2;
+                        renderer->fillRect(&box, 0x80, 0x80, 0xff, 0xff*m_opacity);
+                        continue;
+                    }
+
                     float tick = m_time * 2.0;
                     float color = ((255.0/2) * (cos(tick+(1+x)*(1+y)/20.2))) + (255.0/2);
                     float opacity2 = fabs(sin(x+tick/2.3+y)*cos(y+tick/2.3+x));
                     float size = fabs(sin(tick+(1+x)*(1+y)/20.2)) * opacity2;
 
-                    int pos_x = origin_x + (x * box_width + (box_width/2));
-                    int pos_y = origin_y + (y * box_width + (box_width/2));
-
                     /* And magic happens */
                     if( m_opacity < 1.0 ) {
-                        pos_x += (sin(x+m_time)*cos(y) * screen->w) * (1.0 - m_opacity);
-                        pos_y += (cos(y+m_time)*sin(x) * screen->h) * (1.0 - m_opacity);
+                        pos_x += (sin(x+m_time)*cos(y) * renderer->width()) * (1.0 - m_opacity);
+                        pos_y += (cos(y+m_time)*sin(x) * renderer->height()) * (1.0 - m_opacity);
                     }
 
                     int radius = (size * (box_width/4)) + (box_width/5);
-                    filledCircleRGBA(screen, pos_x, pos_y, radius, color, 0xff-color, 0xff, 0xff*opacity2*m_opacity);
+                    if( quality().particle_detail > 1 ) {
+                        renderer->filledCircle(pos_x, pos_y, radius, color, 0xff-color, 0xff, 0xff*opacity2*m_opacity);
+                    }
+                    else {
+                        SDL_Rect box;
+                        box.x = pos_x - radius;
+                        box.y = pos_y - radius;
+                        box.w = box.h = radius * 2;
+                        renderer->fillRect(&box, color, 0xff-color, 0xff, 0xff*opacity2*m_opacity);
+                    }
                 }
             }
         }
@@ -738,14 +1931,28 @@ public:
             if( (event && event->type == SDL_KEYDOWN) || millitime() >= m_introend ) {
                 delete m_subscene;
                 m_subscene = new Game_Scene(width(), height());
+                m_subscene->setQuality(quality());
                 m_intro = false;
             }
         }
         m_subscene->think(event);
     }
 
-    virtual void draw(SDL_Surface *screen) {
-        m_subscene->draw(screen);
+    virtual void draw(Renderer *renderer) {
+        m_subscene->draw(renderer);
+    }
+
+    virtual void setQuality(const Quality &quality) {
+        Scene::setQuality(quality);
+        m_subscene->setQuality(quality);
+    }
+
+    virtual double idleUntil() {
+        double until = m_subscene->idleUntil();
+        if( m_intro && until > m_introend ) {
+            until = m_introend;
+        }
+        return until;
     }
 
 private:
@@ -758,52 +1965,202 @@ private:
 class Engine {
 public:
     Engine(int width, int height)
-    : m_scene(NULL), m_screen(NULL), m_quit(false)
+    : m_scene(NULL), m_renderer(NULL), m_governor(GLOBAL_FPS), m_quit(false)
+    , m_visible(true), m_focused(true), m_active_time(0.0), m_idle_time(0.0)
     {
-        SDL_Init( SDL_INIT_VIDEO );
-        m_screen = SDL_SetVideoMode( width, height, 0, SDL_SWSURFACE|SDL_DOUBLEBUF );
+        SDL_Init( SDL_INIT_VIDEO | SDL_INIT_TIMER );
+#ifdef SKYDIVER_SDL2
+        m_window = SDL_CreateWindow("Sky Dive Dan", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                    width, height, 0);
+        m_renderer = new Accelerated_Renderer(m_window);
+#else
+        SDL_Surface *screen = SDL_SetVideoMode( width, height, 0, SDL_SWSURFACE|SDL_DOUBLEBUF );
         SDL_WM_SetCaption("Sky Dive Dan", 0);
+        m_renderer = new Software_Renderer(screen);
+
+        SDL_EnableKeyRepeat(1000/30,1000/30);
+#endif
 
         SDL_initFramerate(&m_fps);
         SDL_setFramerate(&m_fps, GLOBAL_FPS);
-
-        SDL_EnableKeyRepeat(1000/30,1000/30);
     }
 
     void setScene( Scene *scene ) {
         m_scene = scene;
+        m_scene->setQuality(m_governor.quality());
+    }
+
+    Quality_Governor *governor() {
+        return &m_governor;
+    }
+
+    void report(FILE *out) {
+        fprintf(out, "quality level %d/%d, %d steps down, %d steps up, %.1f ms/frame\n",
+                m_governor.level(), QUALITY_LEVEL_COUNT - 1,
+                m_governor.stepsDown(), m_governor.stepsUp(),
+                m_governor.averageFrameTime() * 1000.0);
+        fprintf(out, "%.1fs active, %.1fs idle\n", m_active_time, m_idle_time);
     }
 
     ~Engine() {
+        delete m_renderer;
+#ifdef SKYDIVER_SDL2
+        SDL_DestroyWindow(m_window);
+#endif
         SDL_Quit();
     }
 
-    void run() {
+    /* False while minimised or in the background, nobody is watching */
+    bool isActive() {
+        return m_visible && m_focused;
+    }
+
+    /* Runs until quit, or for 'frames' rendered ticks when non-zero */
+    void run(uint64_t frames = 0) {
         uint64_t tick = 0;
-        while( ! m_quit ) {
-            tick++;
-            bool has_event = false;
-            if( SDL_PollEvent(&m_event) ) {
-                has_event = true;
-                if( m_event.type == SDL_QUIT ) {
-                    m_quit = true;
-                }
+        while( ! m_quit && (! frames || tick < frames) ) {
+            bool has_event;
+
+            // Block rather than render frames which wouldn't change or be seen
+            double until = isActive() ? m_scene->idleUntil() : HUGE_VAL;
+            if( until > 0.0 ) {
+                double idle_start = millitime();
+                has_event = until > idle_start && nextEvent(&m_event, until - idle_start);
+                m_idle_time += millitime() - idle_start;
+
+                // Resets the pacing, so it doesn't try to catch up afterwards
+                SDL_setFramerate(&m_fps, GLOBAL_FPS);
+            }
+            else {
+                has_event = nextEvent(&m_event, 0.0);
+            }
+
+            if( has_event ) {
+                handleEvent(&m_event);
+            }
+            if( ! isActive() ) {
+                continue;
             }
 
+            tick++;
+            double start = millitime();
             m_scene->think(has_event ? &m_event : NULL);
-            m_scene->draw(m_screen);
+            m_scene->draw(m_renderer);
+
+            m_renderer->present();
 
-            SDL_Flip(m_screen); 
+            // Time spent producing the frame, not waiting for the next one
+            if( m_governor.frame(millitime() - start) ) {
+                m_renderer->setRenderScale(m_governor.quality().render_scale);
+                m_scene->setQuality(m_governor.quality());
+            }
             SDL_framerateDelay(&m_fps);
+            m_active_time += millitime() - start;
         }
     }
 
 private:
+    /**
+     * Next event, waiting up to 'timeout' seconds for one: 0.0 polls and
+     * HUGE_VAL waits for ever. Returns false if there wasn't one.
+     */
+    bool nextEvent(SDL_Event *event, double timeout) {
+        int got;
+        if( timeout <= 0.0 ) {
+            got = SDL_PollEvent(event);
+        }
+#ifdef SKYDIVER_SDL2
+        else if( timeout >= INT_MAX / 1000 ) {
+            got = SDL_WaitEvent(event);
+        }
+        else {
+            got = SDL_WaitEventTimeout(event, (timeout * 1000) + 1);
+        }
+#else
+        else {
+            // No timed wait in SDL 1.2, a timer posts an event to wake us instead
+            SDL_TimerID timer = NULL;
+            if( timeout < INT_MAX / 1000 ) {
+                timer = SDL_AddTimer((timeout * 1000) + 1, postWakeEvent, NULL);
+            }
+            got = SDL_WaitEvent(event);
+            if( timer ) {
+                SDL_RemoveTimer(timer);
+            }
+        }
+
+        // Including one from a timer which fired after we'd already woken
+        if( got && event->type == SDL_USEREVENT && event->user.code == WAKE_EVENT ) {
+            got = 0;
+        }
+#endif
+        return got != 0;
+    }
+
+#ifndef SKYDIVER_SDL2
+    static const int WAKE_EVENT = 1;
+
+    static Uint32 postWakeEvent(Uint32 interval, void *param) {
+        SDL_Event event;
+        event.type = SDL_USEREVENT;
+        event.user.code = WAKE_EVENT;
+        event.user.data1 = NULL;
+        event.user.data2 = NULL;
+        SDL_PushEvent(&event);
+        return 0;
+    }
+#endif
+
+    void handleEvent(SDL_Event *event) {
+        if( event->type == SDL_QUIT ) {
+            m_quit = true;
+        }
+#ifdef SKYDIVER_SDL2
+        else if( event->type == SDL_WINDOWEVENT ) {
+            switch( event->window.event ) {
+            case SDL_WINDOWEVENT_MINIMIZED:
+            case SDL_WINDOWEVENT_HIDDEN:
+                m_visible = false;
+                break;
+            case SDL_WINDOWEVENT_RESTORED:
+            case SDL_WINDOWEVENT_MAXIMIZED:
+            case SDL_WINDOWEVENT_SHOWN:
+            case SDL_WINDOWEVENT_EXPOSED:
+                m_visible = true;
+                break;
+            case SDL_WINDOWEVENT_FOCUS_LOST:
+                m_focused = false;
+                break;
+            case SDL_WINDOWEVENT_FOCUS_GAINED:
+                m_focused = true;
+                break;
+            }
+        }
+#else
+        else if( event->type == SDL_ACTIVEEVENT ) {
+            if( event->active.state & SDL_APPACTIVE ) {
+                m_visible = event->active.gain;
+            }
+            if( event->active.state & SDL_APPINPUTFOCUS ) {
+                m_focused = event->active.gain;
+            }
+        }
+#endif
+    }
+
     Scene *m_scene;
-    SDL_Surface *m_screen;
+#ifdef SKYDIVER_SDL2
+    SDL_Window *m_window;
+#endif
+    Renderer *m_renderer;
+    Quality_Governor m_governor;
     SDL_Event m_event;
     FPSmanager m_fps;
     bool m_quit;
+    bool m_visible;
+    bool m_focused;
+    double m_active_time;
+    double m_idle_time;
 };
 
 int main(int argc, char **argv) {
@@ -811,6 +2168,7 @@ int main(int argc, char **argv) {
     Engine game(800, 600);
     Intro2Game_Controller_Scene intro(800, 600);
     game.setScene(&intro);
-    game.run();
+    game.run(argc > 1 ? strtoull(argv[1], NULL, 10) : 0);
+    game.report(stderr);
     return 0; 
 }
\ No newline at end of file